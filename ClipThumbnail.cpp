@@ -0,0 +1,39 @@
+#include "ClipThumbnail.h"
+
+std::unique_ptr<ClipThumbnail> ClipThumbnail::create (const float* samples, int numSamples,
+                                                      const float* latentData, int numLatentChannels, int numLatentFrames)
+{
+    auto thumbnail = std::make_unique<ClipThumbnail>();
+    thumbnail->numSamples = numSamples;
+    thumbnail->waveformMin.assign (numWaveformBins, 0.0f);
+    thumbnail->waveformMax.assign (numWaveformBins, 0.0f);
+
+    for (int bin = 0; bin < numWaveformBins && numSamples > 0; ++bin)
+    {
+        auto start = static_cast<int> (static_cast<juce::int64> (bin) * numSamples / numWaveformBins);
+        auto end = juce::jmax (start + 1, static_cast<int> (static_cast<juce::int64> (bin + 1) * numSamples / numWaveformBins));
+        end = juce::jmin (end, numSamples);
+
+        auto range = juce::Range<float>::findMinAndMax (samples + start, end - start);
+        thumbnail->waveformMin[static_cast<size_t> (bin)] = range.getStart();
+        thumbnail->waveformMax[static_cast<size_t> (bin)] = range.getEnd();
+    }
+
+    if (latentData != nullptr && numLatentChannels > 0 && numLatentFrames > 0)
+    {
+        const auto total = static_cast<size_t> (numLatentChannels * numLatentFrames);
+        thumbnail->numLatentChannels = numLatentChannels;
+        thumbnail->numLatentFrames = numLatentFrames;
+        thumbnail->latents.assign (latentData, latentData + total);
+
+        float peak = 0.0f;
+        for (auto value : thumbnail->latents)
+            peak = juce::jmax (peak, std::abs (value));
+
+        const float scale = peak > 0.0f ? 0.5f / peak : 0.0f;
+        for (auto& value : thumbnail->latents)
+            value = 0.5f + value * scale;
+    }
+
+    return thumbnail;
+}
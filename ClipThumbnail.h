@@ -0,0 +1,28 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <vector>
+
+//==============================================================================
+// Reduced view of one decode: min/max waveform bins and the latent frames
+// normalised for display. Built once per decode on the decoder thread and
+// never modified afterwards, so the editor can keep it as long as it likes.
+struct ClipThumbnail
+{
+    static const int numWaveformBins = 512;
+
+    static std::unique_ptr<ClipThumbnail> create (const float* samples, int numSamples,
+                                                  const float* latentData, int numLatentChannels, int numLatentFrames);
+
+    int numSamples = 0;
+    std::vector<float> waveformMin, waveformMax;
+
+    // channel-major, 0.5 is zero, 0 and 1 the largest magnitude in this decode
+    int numLatentChannels = 0, numLatentFrames = 0;
+    std::vector<float> latents;
+
+    float getLatent (int channel, int frame) const noexcept
+    {
+        return latents[static_cast<size_t> (channel * numLatentFrames + frame)];
+    }
+};
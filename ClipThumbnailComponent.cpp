@@ -0,0 +1,87 @@
+#include "ClipThumbnailComponent.h"
+
+static const juce::Colour backgroundColour (0xff181818);
+static const juce::Colour waveformColour (0xffe8a23a);
+
+//==============================================================================
+ClipThumbnailComponent::ClipThumbnailComponent (AudioPluginAudioProcessor& p)
+    : processorRef (p)
+{
+    setOpaque (true);
+    processorRef.addThumbnailListener (this);
+    thumbnail = processorRef.getThumbnail();
+}
+
+ClipThumbnailComponent::~ClipThumbnailComponent()
+{
+    processorRef.removeThumbnailListener (this);
+}
+
+//==============================================================================
+void ClipThumbnailComponent::paint (juce::Graphics& g)
+{
+    if (image.isValid())
+        g.drawImageAt (image, 0, 0);
+    else
+        g.fillAll (backgroundColour);
+}
+
+void ClipThumbnailComponent::resized()
+{
+    renderImage();
+}
+
+void ClipThumbnailComponent::changeListenerCallback (juce::ChangeBroadcaster*)
+{
+    thumbnail = processorRef.getThumbnail();
+    renderImage();
+    repaint();
+}
+
+//==============================================================================
+void ClipThumbnailComponent::renderImage()
+{
+    if (getWidth() <= 0 || getHeight() <= 0)
+    {
+        image = {};
+        return;
+    }
+
+    image = juce::Image (juce::Image::RGB, getWidth(), getHeight(), true);
+    juce::Graphics g (image);
+    g.fillAll (backgroundColour);
+
+    if (thumbnail == nullptr)
+        return;
+
+    auto area = image.getBounds();
+    auto hasLatents = thumbnail->numLatentFrames > 0;
+    auto waveformArea = hasLatents ? area.removeFromTop (area.getHeight() * 3 / 5) : area;
+
+    // one vertical line per pixel column from the bin's min to its max
+    g.setColour (waveformColour);
+    const float centre = static_cast<float> (waveformArea.getCentreY());
+    const float halfHeight = waveformArea.getHeight() * 0.5f;
+    for (int x = 0; x < waveformArea.getWidth(); ++x)
+    {
+        auto bin = static_cast<size_t> (x * ClipThumbnail::numWaveformBins / waveformArea.getWidth());
+        auto top = centre - juce::jlimit (-1.0f, 1.0f, thumbnail->waveformMax[bin]) * halfHeight;
+        auto bottom = centre - juce::jlimit (-1.0f, 1.0f, thumbnail->waveformMin[bin]) * halfHeight;
+        g.drawVerticalLine (waveformArea.getX() + x, top, juce::jmax (bottom, top + 1.0f));
+    }
+
+    if (! hasLatents)
+        return;
+
+    // one pixel per latent value, scaled up to the remaining area
+    juce::Image heatmap (juce::Image::RGB, thumbnail->numLatentFrames, thumbnail->numLatentChannels, false);
+    for (int channel = 0; channel < thumbnail->numLatentChannels; ++channel)
+        for (int frame = 0; frame < thumbnail->numLatentFrames; ++frame)
+        {
+            auto value = thumbnail->getLatent (channel, frame);
+            heatmap.setPixelAt (frame, channel, juce::Colour::fromHSV (0.66f * (1.0f - value), 0.8f, 0.3f + 0.7f * value, 1.0f));
+        }
+
+    g.setImageResamplingQuality (juce::Graphics::lowResamplingQuality);
+    g.drawImage (heatmap, area.toFloat());
+}
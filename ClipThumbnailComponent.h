@@ -0,0 +1,30 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+// Waveform of the current decode with a heatmap of its latent frames below.
+// The processor pushes a new ClipThumbnail after each decode; it is rendered
+// into an image once, so paint() only has to blit that image.
+class ClipThumbnailComponent : public juce::Component,
+                               private juce::ChangeListener
+{
+public:
+    explicit ClipThumbnailComponent (AudioPluginAudioProcessor&);
+    ~ClipThumbnailComponent() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    void changeListenerCallback (juce::ChangeBroadcaster*) override;
+    void renderImage();
+
+    AudioPluginAudioProcessor& processorRef;
+    std::shared_ptr<const ClipThumbnail> thumbnail;
+    juce::Image image;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClipThumbnailComponent)
+};
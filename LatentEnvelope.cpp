@@ -0,0 +1,84 @@
+#include "LatentEnvelope.h"
+
+const juce::Identifier LatentEnvelope::envelopesType  ("ENVELOPES");
+const juce::Identifier LatentEnvelope::envelopeType   ("ENVELOPE");
+const juce::Identifier LatentEnvelope::pointType      ("POINT");
+const juce::Identifier LatentEnvelope::controlProperty ("control");
+const juce::Identifier LatentEnvelope::xProperty      ("x");
+const juce::Identifier LatentEnvelope::yProperty      ("y");
+
+constexpr float LatentEnvelope::minOffset;
+constexpr float LatentEnvelope::maxOffset;
+
+//==============================================================================
+LatentEnvelope::LatentEnvelope (const juce::ValueTree& envelopeTree)
+{
+    for (const auto& point : envelopeTree)
+    {
+        if (! point.hasType (pointType))
+            continue;
+
+        points.add ({ juce::jlimit (0.0f, 1.0f, static_cast<float> (point[xProperty])),
+                      juce::jlimit (minOffset, maxOffset, static_cast<float> (point[yProperty])) });
+    }
+
+    std::sort (points.begin(), points.end(), [] (const juce::Point<float>& a, const juce::Point<float>& b)
+    {
+        return a.x < b.x;
+    });
+}
+
+float LatentEnvelope::getValueAt (float x) const noexcept
+{
+    if (points.isEmpty())
+        return 0.0f;
+
+    if (x <= points.getFirst().x)
+        return points.getFirst().y;
+
+    for (int i = 1; i < points.size(); ++i)
+    {
+        const auto& a = points.getReference (i - 1);
+        const auto& b = points.getReference (i);
+
+        if (x <= b.x)
+            return b.x > a.x ? juce::jmap (x, a.x, b.x, a.y, b.y) : b.y;
+    }
+
+    return points.getLast().y;
+}
+
+void LatentEnvelope::render (float* dest, int numFrames, float baseValue) const noexcept
+{
+    if (points.isEmpty() || numFrames <= 1)
+    {
+        std::fill (dest, dest + juce::jmax (0, numFrames), baseValue + getValueAt (0.0f));
+        return;
+    }
+
+    const float frameToX = 1.0f / static_cast<float> (numFrames - 1);
+
+    for (int frame = 0; frame < numFrames; ++frame)
+        dest[frame] = baseValue + getValueAt (static_cast<float> (frame) * frameToX);
+}
+
+//==============================================================================
+juce::ValueTree LatentEnvelope::getOrCreateTree (juce::ValueTree state, int control)
+{
+    auto envelopes = state.getOrCreateChildWithName (envelopesType, nullptr);
+    auto envelope = envelopes.getChildWithProperty (controlProperty, control);
+
+    if (! envelope.isValid())
+    {
+        envelope = juce::ValueTree (envelopeType);
+        envelope.setProperty (controlProperty, control, nullptr);
+        envelopes.appendChild (envelope, nullptr);
+    }
+
+    return envelope;
+}
+
+juce::ValueTree LatentEnvelope::getTree (const juce::ValueTree& state, int control)
+{
+    return state.getChildWithName (envelopesType).getChildWithProperty (controlProperty, control);
+}
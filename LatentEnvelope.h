@@ -0,0 +1,39 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <juce_data_structures/juce_data_structures.h>
+#include <juce_graphics/juce_graphics.h>
+
+//==============================================================================
+// Breakpoint curve for one latent control. x runs over the clip's latent frames
+// (0 = first frame, 1 = last frame) and y is an offset added on top of the
+// control's knob value. An envelope without breakpoints adds nothing.
+//
+// Envelopes are stored in the parameter state as
+//   <ENVELOPES> <ENVELOPE control="0"> <POINT x="0.1" y="2.0"/> ... </ENVELOPE> </ENVELOPES>
+// so they are saved with the session and shared between processor and editor.
+class LatentEnvelope
+{
+public:
+    static const juce::Identifier envelopesType, envelopeType, pointType;
+    static const juce::Identifier controlProperty, xProperty, yProperty;
+    static constexpr float minOffset = -7.0f, maxOffset = 7.0f;
+
+    LatentEnvelope() = default;
+    explicit LatentEnvelope (const juce::ValueTree& envelopeTree);
+
+    bool isEmpty() const noexcept   { return points.isEmpty(); }
+    const juce::Array<juce::Point<float>>& getPoints() const noexcept   { return points; }
+
+    float getValueAt (float x) const noexcept;
+
+    // Writes baseValue plus the curve sampled at each of the numFrames latent frames.
+    void render (float* dest, int numFrames, float baseValue) const noexcept;
+
+    // Returns the <ENVELOPE> child for a control, creating it (and <ENVELOPES>) if needed.
+    static juce::ValueTree getOrCreateTree (juce::ValueTree state, int control);
+    static juce::ValueTree getTree (const juce::ValueTree& state, int control);
+
+private:
+    juce::Array<juce::Point<float>> points; // sorted by x
+};
@@ -0,0 +1,202 @@
+#include "LatentEnvelopeComponent.h"
+
+static const int buttonColumnWidth = 36;
+static const float pointRadius = 4.0f;
+
+//==============================================================================
+LatentEnvelopeComponent::LatentEnvelopeComponent (juce::AudioProcessorValueTreeState& parameterTree,
+                                                  int numberOfControls)
+    : parameters (parameterTree), numControls (numberOfControls)
+{
+    // One toggle per latent control to choose which envelope is being edited.
+    for (int i = 0; i < numControls; ++i)
+    {
+        auto* button = controlButtons.add (new juce::TextButton (juce::String (i + 1)));
+        button->setClickingTogglesState (true);
+        button->setRadioGroupId (1);
+        button->onClick = [this, i] { setSelectedControl (i); };
+        addAndMakeVisible (button);
+    }
+    controlButtons[0]->setToggleState (true, juce::dontSendNotification);
+
+    parameters.state.addListener (this);
+}
+
+LatentEnvelopeComponent::~LatentEnvelopeComponent()
+{
+    parameters.state.removeListener (this);
+}
+
+void LatentEnvelopeComponent::setSelectedControl (int control)
+{
+    selectedControl = juce::jlimit (0, numControls - 1, control);
+    controlButtons[selectedControl]->setToggleState (true, juce::dontSendNotification);
+    repaint();
+}
+
+//==============================================================================
+void LatentEnvelopeComponent::paint (juce::Graphics& g)
+{
+    auto area = getGraphArea();
+
+    g.setColour (juce::Colours::black.withAlpha (0.6f));
+    g.fillRoundedRectangle (area, 4.0f);
+
+    // zero offset line
+    g.setColour (juce::Colours::white.withAlpha (0.2f));
+    g.drawHorizontalLine (juce::roundToInt (toScreen ({ 0.0f, 0.0f }).y), area.getX(), area.getRight());
+
+    // Draw the other controls faintly underneath the one being edited.
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int control = 0; control < numControls; ++control)
+        {
+            bool isSelected = control == selectedControl;
+            if (isSelected != (pass == 1))
+                continue;
+
+            LatentEnvelope envelope (LatentEnvelope::getTree (parameters.state, control));
+            auto colour = juce::Colours::orange.withRotatedHue (static_cast<float> (control) / numControls);
+
+            juce::Path curve;
+            const int steps = juce::jmax (2, static_cast<int> (area.getWidth() / 4.0f));
+            for (int step = 0; step <= steps; ++step)
+            {
+                float x = static_cast<float> (step) / steps;
+                auto position = toScreen ({ x, envelope.getValueAt (x) });
+                if (step == 0)
+                    curve.startNewSubPath (position);
+                else
+                    curve.lineTo (position);
+            }
+
+            g.setColour (isSelected ? colour : colour.withAlpha (0.3f));
+            g.strokePath (curve, juce::PathStrokeType (isSelected ? 2.0f : 1.0f));
+
+            if (isSelected)
+            {
+                for (const auto& point : envelope.getPoints())
+                {
+                    auto position = toScreen (point);
+                    g.fillEllipse (position.x - pointRadius, position.y - pointRadius,
+                                   pointRadius * 2.0f, pointRadius * 2.0f);
+                }
+            }
+        }
+    }
+}
+
+void LatentEnvelopeComponent::resized()
+{
+    auto column = getLocalBounds().removeFromLeft (buttonColumnWidth);
+    const int buttonHeight = column.getHeight() / juce::jmax (1, numControls);
+
+    for (auto* button : controlButtons)
+        button->setBounds (column.removeFromTop (buttonHeight).reduced (2));
+}
+
+//==============================================================================
+void LatentEnvelopeComponent::mouseDown (const juce::MouseEvent& event)
+{
+    auto position = event.position;
+    if (! getGraphArea().contains (position))
+        return;
+
+    draggedPoint = findPointAt (position);
+
+    if (! draggedPoint.isValid())
+    {
+        draggedPoint = juce::ValueTree (LatentEnvelope::pointType);
+        movePoint (draggedPoint, position);
+        LatentEnvelope::getOrCreateTree (parameters.state, selectedControl).appendChild (draggedPoint, nullptr);
+    }
+}
+
+void LatentEnvelopeComponent::mouseDrag (const juce::MouseEvent& event)
+{
+    // Every drag event only updates the state; the decode happens once it settles.
+    if (draggedPoint.isValid())
+        movePoint (draggedPoint, event.position);
+}
+
+void LatentEnvelopeComponent::mouseUp (const juce::MouseEvent&)
+{
+    draggedPoint = {};
+}
+
+void LatentEnvelopeComponent::mouseDoubleClick (const juce::MouseEvent& event)
+{
+    auto point = findPointAt (event.position);
+    if (point.isValid())
+        point.getParent().removeChild (point, nullptr);
+
+    draggedPoint = {};
+}
+
+//==============================================================================
+void LatentEnvelopeComponent::valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&)
+{
+    if (tree.hasType (LatentEnvelope::pointType) || tree.hasType (LatentEnvelope::envelopeType))
+        repaint();
+}
+
+void LatentEnvelopeComponent::valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree&)
+{
+    if (parent.hasType (LatentEnvelope::envelopeType) || parent.hasType (LatentEnvelope::envelopesType))
+        repaint();
+}
+
+void LatentEnvelopeComponent::valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree&, int)
+{
+    if (parent.hasType (LatentEnvelope::envelopeType) || parent.hasType (LatentEnvelope::envelopesType))
+        repaint();
+}
+
+void LatentEnvelopeComponent::valueTreeRedirected (juce::ValueTree&)
+{
+    draggedPoint = {};
+    repaint();
+}
+
+//==============================================================================
+juce::Rectangle<float> LatentEnvelopeComponent::getGraphArea() const
+{
+    return getLocalBounds().withTrimmedLeft (buttonColumnWidth).reduced (4).toFloat();
+}
+
+juce::Point<float> LatentEnvelopeComponent::toScreen (juce::Point<float> point) const
+{
+    auto area = getGraphArea();
+    return { area.getX() + point.x * area.getWidth(),
+             juce::jmap (point.y, LatentEnvelope::maxOffset, LatentEnvelope::minOffset, area.getY(), area.getBottom()) };
+}
+
+juce::Point<float> LatentEnvelopeComponent::fromScreen (juce::Point<float> position) const
+{
+    auto area = getGraphArea();
+    return { juce::jlimit (0.0f, 1.0f, (position.x - area.getX()) / area.getWidth()),
+             juce::jlimit (LatentEnvelope::minOffset, LatentEnvelope::maxOffset,
+                           juce::jmap (position.y, area.getY(), area.getBottom(), LatentEnvelope::maxOffset, LatentEnvelope::minOffset)) };
+}
+
+juce::ValueTree LatentEnvelopeComponent::findPointAt (juce::Point<float> position) const
+{
+    auto envelope = LatentEnvelope::getTree (parameters.state, selectedControl);
+
+    for (const auto& point : envelope)
+    {
+        auto pointPosition = toScreen ({ static_cast<float> (point[LatentEnvelope::xProperty]),
+                                         static_cast<float> (point[LatentEnvelope::yProperty]) });
+        if (pointPosition.getDistanceFrom (position) <= pointRadius * 2.0f)
+            return point;
+    }
+
+    return {};
+}
+
+void LatentEnvelopeComponent::movePoint (juce::ValueTree point, juce::Point<float> position)
+{
+    auto value = fromScreen (position);
+    point.setProperty (LatentEnvelope::xProperty, value.x, nullptr);
+    point.setProperty (LatentEnvelope::yProperty, value.y, nullptr);
+}
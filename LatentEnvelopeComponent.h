@@ -0,0 +1,49 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "LatentEnvelope.h"
+
+//==============================================================================
+// Breakpoint editor for the latent envelopes. Click to add a point, drag to
+// move it, double-click to remove it. Edits go straight into the parameter
+// state; the processor waits for them to settle before decoding.
+class LatentEnvelopeComponent : public juce::Component,
+                                private juce::ValueTree::Listener
+{
+public:
+    LatentEnvelopeComponent (juce::AudioProcessorValueTreeState& parameterTree, int numControls);
+    ~LatentEnvelopeComponent() override;
+
+    void setSelectedControl (int control);
+    // The area the envelopes are drawn in, x spans the whole clip
+    juce::Rectangle<float> getGraphArea() const;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+    void mouseDown (const juce::MouseEvent&) override;
+    void mouseDrag (const juce::MouseEvent&) override;
+    void mouseUp (const juce::MouseEvent&) override;
+    void mouseDoubleClick (const juce::MouseEvent&) override;
+
+private:
+    void valueTreePropertyChanged (juce::ValueTree& tree, const juce::Identifier&) override;
+    void valueTreeChildAdded (juce::ValueTree& parent, juce::ValueTree&) override;
+    void valueTreeChildRemoved (juce::ValueTree& parent, juce::ValueTree&, int) override;
+    void valueTreeRedirected (juce::ValueTree&) override;
+
+    juce::Point<float> toScreen (juce::Point<float> point) const;
+    juce::Point<float> fromScreen (juce::Point<float> position) const;
+    juce::ValueTree findPointAt (juce::Point<float> position) const;
+    void movePoint (juce::ValueTree point, juce::Point<float> position);
+
+    juce::AudioProcessorValueTreeState& parameters;
+    const int numControls;
+    int selectedControl = 0;
+    juce::ValueTree draggedPoint;
+    juce::OwnedArray<juce::TextButton> controlButtons;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatentEnvelopeComponent)
+};
@@ -0,0 +1,148 @@
+#include "MorphCache.h"
+
+// Knob positions closer than this are treated as the same state.
+static const float exactDistance = 1.0e-4f;
+
+//==============================================================================
+MorphCache::MorphCache (SampleMemoryManager& manager, int numberOfControls)
+    : numControls (juce::jmin (numberOfControls, maxControls))
+{
+    jassert (numberOfControls <= maxControls);
+
+    for (auto& entry : entries)
+        entry.slot = std::make_unique<SampleSlot> (manager, true);
+}
+
+float MorphCache::getDistance (const Key& a, const Key& b) const noexcept
+{
+    float sum = 0.0f;
+
+    for (int i = 0; i < numControls; ++i)
+    {
+        auto diff = a.values[static_cast<size_t> (i)] - b.values[static_cast<size_t> (i)];
+        sum += diff * diff;
+    }
+
+    return std::sqrt (sum);
+}
+
+//==============================================================================
+void MorphCache::add (const Key& key, SampleClip::Ptr clip, std::shared_ptr<const ClipThumbnail> thumbnail)
+{
+    if (clip == nullptr || findExact (key) != nullptr)
+        return;
+
+    Entry* entry = nullptr;
+    {
+        const juce::SpinLock::ScopedLockType sl (lock);
+        entry = &entries[static_cast<size_t> (nextEntry)];
+        entry->valid = false;
+        nextEntry = (nextEntry + 1) % numEntries;
+    }
+
+    // The slot publishes outside the cache lock so the audio thread is never
+    // kept waiting behind the memory manager.
+    entry->slot->set (clip);
+
+    {
+        const juce::SpinLock::ScopedLockType sl (lock);
+        entry->key = key;
+        entry->thumbnail.swap (thumbnail);
+        entry->valid = true;
+    }
+    // the replaced thumbnail is freed here, outside the lock
+}
+
+SampleClip::Ptr MorphCache::findExact (const Key& key) const
+{
+    const juce::SpinLock::ScopedLockType sl (lock);
+
+    for (auto& entry : entries)
+        if (entry.valid && isSameState (entry.key, key))
+            return entry.slot->get();
+
+    return nullptr;
+}
+
+std::shared_ptr<const ClipThumbnail> MorphCache::findThumbnail (const Key& key) const
+{
+    const juce::SpinLock::ScopedLockType sl (lock);
+
+    for (auto& entry : entries)
+        if (entry.valid && isSameState (entry.key, key))
+            return entry.thumbnail;
+
+    return nullptr;
+}
+
+bool MorphCache::isSameState (const Key& a, const Key& b) const noexcept
+{
+    return a.envelopeRevision == b.envelopeRevision && getDistance (a, b) < exactDistance;
+}
+
+void MorphCache::clear()
+{
+    std::array<std::shared_ptr<const ClipThumbnail>, numEntries> thumbnails;
+    {
+        const juce::SpinLock::ScopedLockType sl (lock);
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            entries[i].valid = false;
+            thumbnails[i].swap (entries[i].thumbnail);
+        }
+    }
+
+    for (auto& entry : entries)
+        entry.slot->set (nullptr);
+}
+
+bool MorphCache::findNeighbours (const Key& key, Neighbours& result) const noexcept
+{
+    const juce::SpinLock::ScopedTryLockType sl (lock);
+
+    if (! sl.isLocked())
+        return false;
+
+    const Entry* nearest[2] = { nullptr, nullptr };
+    float distances[2] = { 0.0f, 0.0f };
+
+    for (auto& entry : entries)
+    {
+        if (! entry.valid || entry.key.envelopeRevision != key.envelopeRevision)
+            continue;
+
+        auto distance = getDistance (entry.key, key);
+
+        if (nearest[0] == nullptr || distance < distances[0])
+        {
+            nearest[1] = nearest[0];  distances[1] = distances[0];
+            nearest[0] = &entry;      distances[0] = distance;
+        }
+        else if (nearest[1] == nullptr || distance < distances[1])
+        {
+            nearest[1] = &entry;      distances[1] = distance;
+        }
+    }
+
+    // An entry may have been evicted by the memory manager since it was added.
+    if (nearest[0] == nullptr || ! nearest[0]->slot->retainCurrent (result.first) || result.first == nullptr)
+        return false;
+
+    result.exact = distances[0] < exactDistance;
+    result.firstGain = 1.0f;
+    result.secondGain = 0.0f;
+    result.second = nullptr;
+
+    if (result.exact || nearest[1] == nullptr
+         || ! nearest[1]->slot->retainCurrent (result.second) || result.second == nullptr)
+    {
+        result.second = nullptr;
+        return true;
+    }
+
+    // Equal-power crossfade weighted by how close each neighbour is.
+    auto position = distances[0] / (distances[0] + distances[1]);
+    result.firstGain  = std::cos (position * juce::MathConstants<float>::halfPi);
+    result.secondGain = std::sin (position * juce::MathConstants<float>::halfPi);
+    return true;
+}
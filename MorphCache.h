@@ -0,0 +1,66 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include "SampleStorage.h"
+#include "ClipThumbnail.h"
+
+//==============================================================================
+// Keeps the last few decoded states (latent knob positions plus the envelope
+// revision they were decoded with) so a note triggered while a new decode is
+// still running can play a blend of the closest ones instead of stale audio.
+// Entries live in evictable slots, so the memory manager may drop them. Each
+// entry also keeps its thumbnail, so a cache hit doesn't have to rebuild it.
+class MorphCache
+{
+public:
+    static const int numEntries = 8;
+    static const int maxControls = 8;
+
+    struct Key
+    {
+        std::array<float, maxControls> values {};
+        int envelopeRevision = -1;
+    };
+
+    struct Neighbours
+    {
+        SampleClip::Ptr first, second;
+        float firstGain = 1.0f, secondGain = 0.0f;
+        bool exact = false;
+    };
+
+    MorphCache (SampleMemoryManager& manager, int numControls);
+
+    // Decode thread: remembers a freshly decoded clip, replacing the oldest entry.
+    void add (const Key& key, SampleClip::Ptr clip, std::shared_ptr<const ClipThumbnail> thumbnail);
+    SampleClip::Ptr findExact (const Key& key) const;
+    std::shared_ptr<const ClipThumbnail> findThumbnail (const Key& key) const;
+    // True if both keys would decode to the same clip.
+    bool isSameState (const Key& a, const Key& b) const noexcept;
+    // Forgets every entry, e.g. after a new file has been encoded.
+    void clear();
+
+    // Audio thread: finds the two closest entries decoded with the same envelopes
+    // and their equal-power gains. Returns false if nothing usable was found or
+    // the cache is being written to.
+    bool findNeighbours (const Key& key, Neighbours& result) const noexcept;
+
+private:
+    float getDistance (const Key& a, const Key& b) const noexcept;
+
+    struct Entry
+    {
+        Key key;
+        bool valid = false;
+        std::unique_ptr<SampleSlot> slot;
+        std::shared_ptr<const ClipThumbnail> thumbnail;
+    };
+
+    const int numControls;
+    std::array<Entry, numEntries> entries;
+    int nextEntry = 0;
+    mutable juce::SpinLock lock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MorphCache)
+};
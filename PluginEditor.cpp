@@ -5,6 +5,9 @@
 #include "BinaryData.h"
 //#endif
 
+static const int envelopePanelHeight = 140;
+static const int thumbnailHeight = 90;
+
 //==============================================================================
 AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAudioProcessor& p,
     juce::AudioProcessorValueTreeState& parameterTree)
@@ -29,7 +32,9 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     latentcontrol5_Attachment(parameterTree, "5-control", latentcontrol5_Slider),
     // randomisation control
     rand_Slider(juce::Slider::LinearVertical, juce::Slider::NoTextBox),
-    rand_Slider_Attachment(parameterTree, "rand", rand_Slider)
+    rand_Slider_Attachment(parameterTree, "rand", rand_Slider),
+    thumbnailView(p),
+    envelopeEditor(parameterTree, 5)
 
 {
     // Add the backround to our editor component.
@@ -51,16 +56,20 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
 
     addAndMakeVisible(rand_Slider);
 
+    addAndMakeVisible(thumbnailView);
+    addAndMakeVisible(envelopeEditor);
+
 
     // Not resizable!
     setResizable (false, 
                   false); 
 
     // To make our editor the same size as the background image we can get the
-    // drawable bounds of the image. We then use these to set the editor's size.
+    // drawable bounds of the image. We then use these to set the editor's size,
+    // leaving room for the thumbnail and envelope panel underneath.
     auto bgBounds = background->getDrawableBounds();
     setSize (bgBounds.getWidth(),
-            bgBounds.getHeight());
+            bgBounds.getHeight() + thumbnailHeight + envelopePanelHeight);
 }
 
 AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor()
@@ -70,13 +79,21 @@ AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor()
 //==============================================================================
 void AudioPluginAudioProcessorEditor::paint (juce::Graphics& g)
 {
-    // Nothing to do here as our image Drawable will serve as the editor's background.
+    // Our image Drawable serves as the editor's background, only the panel underneath needs filling.
+    g.fillAll (juce::Colour (0xff202020));
 }
 
 void AudioPluginAudioProcessorEditor::resized()
 {
-    // Set the image to take up the entire editor.
-    background->setBounds(getLocalBounds());
+    // Set the image to take up the editor above the thumbnail and envelope panel.
+    auto area = getLocalBounds();
+    envelopeEditor.setBounds(area.removeFromBottom(envelopePanelHeight).reduced(10, 6));
+    auto thumbnailArea = area.removeFromBottom(thumbnailHeight).reduced(10, 6);
+    background->setBounds(area);
+
+    // Line the thumbnail up with the envelope graph so both share a time axis.
+    auto graphArea = envelopeEditor.getGraphArea().getSmallestIntegerContainer() + envelopeEditor.getPosition();
+    thumbnailView.setBounds(thumbnailArea.withLeft(graphArea.getX()).withRight(graphArea.getRight()));
 
     // Set the position of the file chooser button in the top left corner.
     fileChooserButton.setBounds(30, 30, 120, 50);
@@ -127,6 +144,7 @@ void AudioPluginAudioProcessorEditor::buttonClicked (juce::Button* button)
                 // TODO Pass the file path to the processor
                 processorRef.filePath = newfilePath;
                 processorRef.newfile.clear();
+                processorRef.requestUpdate();
             }
             else
             {
@@ -2,6 +2,8 @@
 
 //#include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "LatentEnvelopeComponent.h"
+#include "ClipThumbnailComponent.h"
 //==============================================================================
 class AudioPluginAudioProcessorEditor : public juce::AudioProcessorEditor, public juce::Button::Listener
 {
@@ -55,6 +57,11 @@ private:
     juce::Slider rand_Slider;
     SliderAttachment rand_Slider_Attachment;
 
+    // Decoded waveform/latent overview and latent envelopes, shown in a strip
+    // below the background image
+    ClipThumbnailComponent thumbnailView;
+    LatentEnvelopeComponent envelopeEditor;
+
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioPluginAudioProcessorEditor)
 };
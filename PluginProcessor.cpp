@@ -7,6 +7,9 @@
 #include <c10/core/InferenceMode.h>
 
 static const int vector_num = 5;
+// scales rand into the standard deviation of the per-note latent offset,
+// i.e. 1.0 at full randomisation (rand = 0.5)
+static const float latentJitterScale = 2.0f;
 static const juce::String controlIdSuffix = "-control";
 static const juce::String controlNameSuffix = " Control";
 
@@ -28,6 +31,10 @@ static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout
                                                                             0.0f,
                                                                             0.5f,
                                                                             0.0f));   
+    // store decoded clips as int16 instead of float32 to save memory
+    playback_group->addChild (std::make_unique <juce::AudioParameterBool> ("compact",
+                                                                           "Compact Storage",
+                                                                           false));
     parameters.add(std::move(playback_group));                                                        
 
     auto latent_group = std::make_unique <juce::AudioProcessorParameterGroup>("latentcontrol",
@@ -50,7 +57,8 @@ static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout
 //==============================================================================
 AudioPluginAudioProcessor::AudioPluginAudioProcessor()
     : parameters (*this, nullptr, "parameters", createParameterLayout()),
-      AudioProcessor (BusesProperties().withOutput ("Output", juce::AudioChannelSet::mono(), true))
+      AudioProcessor (BusesProperties().withOutput ("Output", juce::AudioChannelSet::mono(), true)),
+      morphCache (*memoryManager, vector_num)
 {
     parameters.state.addListener(this); // monitor parameter change
     populateParameterValues();
@@ -69,10 +77,16 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
     filePath = default_audio_file;
     // clear to load default audio file from filePath
     newfile.clear();
+    refreshEnvelopes();
+    for (auto& slot : variantSlots)
+        slot = std::make_unique<SampleSlot>(*memoryManager, true);
+    decodeThread.startThread();
 }
 
 AudioPluginAudioProcessor::~AudioPluginAudioProcessor()
 {
+    decodeThread.stopThread(4000);
+    delete pendingThumbnail.exchange(nullptr);
 }
 
 //==============================================================================
@@ -97,47 +111,74 @@ void AudioPluginAudioProcessor::encoder()
     std::vector<torch::jit::IValue> model_inputs;
     model_inputs.push_back(audioIValue);
 
+    const juce::ScopedLock sl(modelLock);
     c10::InferenceMode guard;
     encoded_input = model.get_method("encode")(model_inputs).toTensor();
 }
 
-void AudioPluginAudioProcessor::mod_latent() 
+torch::Tensor AudioPluginAudioProcessor::mod_latent(MorphCache::Key& key) 
 {
-    latent_vectors = encoded_input; // copy original encoded value to modify
-    for (int i = 0; i < vector_num; ++i) {
-        auto current_val = latent_controls[i]->load();
-        delta = torch::full({ 1, 1, latent_vectors.size(-1) }, current_val, torch::kFloat32); //3D tensor
-        index = torch::tensor({ i }, torch::kLong); // index tensor should have shape [1]
-        // add delta to the ith vector in the second dimenstion of latent_vectors
-        latent_vectors = at::index_add(latent_vectors, 1, index, delta);  
+    auto num_frames = encoded_input.size(-1);
+    // knob value plus envelope offset for every control at every latent frame
+    std::vector<float> offsets(vector_num * num_frames);
+    {
+        const juce::ScopedLock sl(envelopeLock);
+        for (int i = 0; i < vector_num; ++i) {
+            envelopes[i].render(offsets.data() + i * num_frames, static_cast<int>(num_frames), key.values[i]);
+        }
+        // the revision that matches the envelopes actually used
+        key.envelopeRevision = envelopeRevision.load();
     }
+    auto delta = torch::from_blob(offsets.data(), { 1, vector_num, num_frames }, torch::kFloat32); //3D tensor
+    c10::InferenceMode guard;
+    auto modified = encoded_input.clone(); // copy original encoded value to modify
+    // add all offsets at once to the first vector_num vectors in the second dimension
+    modified.narrow(1, 0, vector_num).add_(delta);
+    return modified;
 }
 
-void AudioPluginAudioProcessor::decoder() 
+torch::Tensor AudioPluginAudioProcessor::run_decoder(const torch::Tensor& latents)
 {
-    torch::jit::IValue latentIValue = latent_vectors;
+    torch::jit::IValue latentIValue = latents;
     // Add the c10::IValue to a std::vector<c10::IValue>
     std::vector<torch::jit::IValue> decoder_inputs;
     decoder_inputs.push_back(latentIValue);
+    const juce::ScopedLock sl(modelLock);
     c10::InferenceMode guard;
-    decoded_output = model.get_method("decode")(decoder_inputs).toTensor();
+    return model.get_method("decode")(decoder_inputs).toTensor();
+}
+
+void AudioPluginAudioProcessor::probeBatchedDecode()
+{
+    // streaming exports only accept a batch of one, find out once rather than
+    // on every offline note
+    try {
+        auto output = run_decoder(encoded_input.repeat({ 2, 1, 1 }));
+        batchedDecode.store(output.size(0) == 2);
+    }
+    catch (const c10::Error&) {
+        batchedDecode.store(false);
+    }
+}
+
+void AudioPluginAudioProcessor::decoder() 
+{
+    // local, so only the clip in decodedClip (which may be compact) outlives the decode
+    auto decoded_output = run_decoder(latent_vectors);
 
     auto output_shape = decoded_output.sizes();
     int output_num_samples = output_shape[2]; // Assuming the shape is {1, numChannels, numSamples}
-    loadedBuffer.setSize(1, output_num_samples, false, true, true);
     auto output_data = decoded_output.view({ 1, output_num_samples }).data_ptr<float>();
-    // write the decoded audio into loadedBuffer
-    for (int sample = 0; sample < loadedBuffer.getNumSamples(); ++sample)
-    {
-        loadedBuffer.setSample(0, sample, output_data[sample]);
-    }
+    // publish the decoded audio as an immutable clip for playback
+    bool compact = compact_storage->load() > 0.5f;
+    decodedClip.set(SampleClip::createFromData(output_data, output_num_samples, compact));
 }
 
 //==============================================================================
 void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {   
     // for playback
-    filePlayer2 = std::make_unique<BufferAudioSource>(loadedBuffer);
+    filePlayer2 = std::make_unique<BufferAudioSource>(decodedClip);
     resampler2 = std::make_unique<juce::ResamplingAudioSource>(filePlayer2.get(), false, 1);
 
     // Set the resampler2's output sample rate
@@ -148,15 +189,35 @@ void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
 
     // Initialise the trigger and gain so that the sample won't be played immediately.
     outputGain = 0.0f;
-    changesApplied.clear(); // we will reset everything before playback everytime
+    requestUpdate(); // we will reset everything before playback everytime
 }
 
 void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
 {
-    updateProcessors();
     juce::ScopedNoDenormals noDenormals;
 
+    // Offline bounces have no deadline, so every note gets its own decode;
+    // realtime playback (or no randomisation, or a model that isn't ready)
+    // uses the precomputed clip
+    renderingOffline.store(isNonRealtime());
+    if (isNonRealtime() && renderOffline(buffer, midiMessages))
+        return;
+
+    // Compare what the host has set right now with what the decoder last published
+    auto blockStart = juce::Time::getMillisecondCounterHiRes();
+    auto currentKey = getCurrentKey();
+    bool pending = isDecodePending(currentKey);
+    if (!morphCache.isSameState(currentKey, measuredKey))
+    {
+        measuredKey = currentKey;
+        keyChangeTime = blockStart;
+        awaitingExact = true;
+        awaitingResponse = true;
+        lastDecodeMs.store(-1.0f);
+        lastResponseMs.store(-1.0f);
+    }
+
     // Process MIDI messages
     juce::MidiMessage midiMessage;
     int sampleNumber;
@@ -166,6 +227,20 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
         {
             // Start playing the audio clip
             filePlayer2->setNextReadPosition (0);
+            decodedClip.markTriggered();
+            filePlayer2->playExact();
+            waitingForExact = false;
+
+            // The current knob positions haven't been decoded yet: blend the
+            // closest cached states and swap to the exact clip once it lands
+            MorphCache::Neighbours neighbours;
+            if (pending && morphCache.findNeighbours(currentKey, neighbours))
+            {
+                filePlayer2->startMorph(neighbours.first, neighbours.firstGain,
+                                        neighbours.second, neighbours.secondGain);
+                morphKey = currentKey;
+                waitingForExact = true;
+            }
             outputGain = 1.0f;
 
             // Randomise pitch and volume
@@ -174,16 +249,36 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
             float pitchFactor = 1.0f + (randomPitch * *rand_control);
             float volumeFactor = 1.0f + (randomVolume * *rand_control);
 
-            // Apply the random pitch
-            resampler2->setResamplingRatio(pitchFactor);
+            // Apply the random pitch on top of the model to host rate conversion,
+            // offline variants use the same base ratio
+            resampler2->setResamplingRatio(pitchFactor * modelSampleRate / getSampleRate());
 
             // Apply the random volume
             outputGain *= volumeFactor;
         }
     }
+    // Swap to the exact decode as soon as it matches the current state
+    if (waitingForExact && !pending && filePlayer2->swapToExact())
+        waitingForExact = false;
+    // a morph found for an older state is as stale as the old exact clip
+    bool stale = waitingForExact ? !morphCache.isSameState(morphKey, currentKey) : pending;
+    bool audible = outputGain > 0.0f && !filePlayer2->hasFinished();
+
     // Create an AudioSourceChannelInfo object for resampler2
     resampler2->getNextAudioBlock (juce::AudioSourceChannelInfo (buffer));
 
+    // Latency from the block that first saw the change
+    if (awaitingExact && !pending)
+    {
+        lastDecodeMs.store(static_cast<float>(blockStart - keyChangeTime));
+        awaitingExact = false;
+    }
+    if (awaitingResponse && audible && !stale)
+    {
+        lastResponseMs.store(static_cast<float>(juce::Time::getMillisecondCounterHiRes() - keyChangeTime));
+        awaitingResponse = false;
+    }
+
     // Apply the gain to silence the initial playback.
     buffer.applyGain(juce::Decibels::decibelsToGain <float>(*output_volume));
     buffer.applyGain (outputGain);
@@ -195,13 +290,191 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     }
 }
 
+bool AudioPluginAudioProcessor::renderOffline (juce::AudioBuffer<float>& buffer,
+                                               juce::MidiBuffer& midiMessages)
+{
+    // without randomisation every variant would be the precomputed clip
+    if (rand_control->load() <= 0.0f)
+        return false;
+
+    // Collect the note-ons, each one plays its own variant
+    std::vector<int> notePositions;
+    juce::MidiMessage midiMessage;
+    int sampleNumber;
+    for (juce::MidiBuffer::Iterator i(midiMessages); i.getNextEvent(midiMessage, sampleNumber);)
+    {
+        if (midiMessage.isNoteOn())
+            notePositions.push_back(juce::jlimit(0, buffer.getNumSamples(), sampleNumber));
+    }
+
+    std::vector<SampleClip::Ptr> variants;
+    if (!notePositions.empty() && !takeVariants(static_cast<int>(notePositions.size()), variants))
+        return false;
+
+    // Render sample accurately, starting each note's variant at its own position
+    float volumeGain = juce::Decibels::decibelsToGain <float>(*output_volume);
+    int position = 0;
+    for (size_t note = 0; note <= notePositions.size(); ++note)
+    {
+        int end = note < notePositions.size() ? notePositions[note] : buffer.getNumSamples();
+        if (end > position)
+        {
+            resampler2->getNextAudioBlock (juce::AudioSourceChannelInfo (&buffer, position, end - position));
+            buffer.applyGain(0, position, end - position, volumeGain * outputGain);
+        }
+        position = end;
+
+        if (note < notePositions.size())
+        {
+            filePlayer2->setNextReadPosition (0);
+            decodedClip.markTriggered();
+            filePlayer2->playClip(variants[note]);
+            waitingForExact = false;
+            // the variation comes from the latents, not from pitch and volume
+            resampler2->setResamplingRatio(modelSampleRate / getSampleRate());
+            outputGain = 1.0f;
+        }
+    }
+
+    // Check if the output is stereo and copy the audio to the right buffer
+    if (buffer.getNumChannels() > 1)
+    {
+        buffer.copyFrom(1, 0, buffer, 0, 0, buffer.getNumSamples());
+    }
+    return true;
+}
+
+bool AudioPluginAudioProcessor::takeVariants (int numNotes, std::vector<SampleClip::Ptr>& variants)
+{
+    auto key = getCurrentKey();
+    float rand = rand_control->load();
+    {
+        // offline only, so waiting for the decode thread is fine
+        const juce::ScopedLock sl(variantLock);
+        if (matchesReadyVariants(key, rand))
+        {
+            auto available = juce::jmin(numNotes, static_cast<int>(readyVariants.size()));
+            variants.assign(readyVariants.begin(), readyVariants.begin() + available);
+            readyVariants.erase(readyVariants.begin(), readyVariants.begin() + available);
+        }
+    }
+
+    auto missing = numNotes - static_cast<int>(variants.size());
+    if (missing > 0)
+    {
+        // nothing decoded ahead yet, e.g. the first notes of a bounce
+        std::vector<SampleClip::Ptr> decoded;
+        if (!decodeVariants(missing, rand, key, decoded))
+            return false;
+        // the decode thread puts them in their slots, until then this list
+        // keeps them alive so the last reference isn't dropped here
+        const juce::ScopedLock sl(variantLock);
+        unregisteredVariants.insert(unregisteredVariants.end(), decoded.begin(), decoded.end());
+        variants.insert(variants.end(), decoded.begin(), decoded.end());
+    }
+    // top the ready variants back up while the host renders the next blocks
+    decodeThread.notify();
+    return true;
+}
+
+bool AudioPluginAudioProcessor::prepareVariants()
+{
+    auto key = getCurrentKey();
+    float rand = rand_control->load();
+    std::vector<SampleClip::Ptr> decoded;
+    int needed = 0;
+    {
+        const juce::ScopedLock sl(variantLock);
+        decoded.swap(unregisteredVariants);
+        if (!renderingOffline.load() || rand <= 0.0f)
+            readyVariants.clear();
+        else if (matchesReadyVariants(key, rand))
+            needed = numReadyVariants - static_cast<int>(readyVariants.size());
+        else
+            needed = numReadyVariants;
+    }
+    registerVariants(decoded);
+    decoded.clear();
+
+    if (needed <= 0 || !decodeVariants(needed, rand, key, decoded))
+        return false;
+    registerVariants(decoded);
+
+    const juce::ScopedLock sl(variantLock);
+    if (!matchesReadyVariants(key, rand))
+    {
+        readyVariants.clear();
+        readyKey = key;
+        readyRand = rand;
+    }
+    readyVariants.insert(readyVariants.end(), decoded.begin(), decoded.end());
+    return true;
+}
+
+void AudioPluginAudioProcessor::registerVariants (const std::vector<SampleClip::Ptr>& variants)
+{
+    for (auto& variant : variants)
+    {
+        // counts towards the memory budget until newer variants replace it,
+        // and is released by the memory manager once the voice is done with it
+        variantSlots[static_cast<size_t>(nextVariantSlot)]->set(variant);
+        nextVariantSlot = (nextVariantSlot + 1) % numVariantSlots;
+    }
+}
+
+bool AudioPluginAudioProcessor::matchesReadyVariants (const MorphCache::Key& key, float rand) const
+{
+    return morphCache.isSameState(readyKey, key) && std::abs(readyRand - rand) < 1.0e-6f;
+}
+
+bool AudioPluginAudioProcessor::decodeVariants (int numNotes, float rand, MorphCache::Key& key,
+                                                std::vector<SampleClip::Ptr>& variants)
+{
+    const juce::ScopedLock sl(modelLock);
+    if (!encoded_input.defined())
+        return false;
+
+    try {
+        auto base = mod_latent(key);
+        c10::InferenceMode guard;
+
+        // one random offset per note and latent control, held across all frames
+        auto batch = base.repeat({ numNotes, 1, 1 });
+        auto jitter = torch::randn({ numNotes, vector_num, 1 }, torch::kFloat32)
+                        * (rand * latentJitterScale);
+        batch.narrow(1, 0, vector_num).add_(jitter);
+
+        torch::Tensor output;
+        if (batchedDecode.load()) {
+            output = run_decoder(batch);
+        }
+        else {
+            // the model only takes a batch of one, decode the notes in turn
+            std::vector<torch::Tensor> outputs;
+            for (int note = 0; note < numNotes; ++note)
+                outputs.push_back(run_decoder(batch.narrow(0, note, 1)));
+            output = torch::cat(outputs, 0);
+        }
+
+        bool compact = compact_storage->load() > 0.5f;
+        for (int note = 0; note < numNotes; ++note)
+        {
+            auto samples = output[note][0].contiguous(); // Assuming the shape is {numNotes, numChannels, numSamples}
+            variants.push_back(SampleClip::createFromData(samples.data_ptr<float>(), static_cast<int>(samples.size(0)), compact));
+        }
+    }
+    catch (const c10::Error& e) {
+        std::cout << "Error decoding note variants: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
 void AudioPluginAudioProcessor::releaseResources()
 {
     // Release resources and reset unique_ptrs
     filePlayer2.reset();
     resampler2.reset();
-    filePlayer1.reset();
-    resampler1.reset();
 }
 
 bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -216,13 +489,15 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
 
 void AudioPluginAudioProcessor::loadAudioFile() 
 {      
-    fileReader1.reset(formatManager.createReaderFor(juce::File(filePath)));
+    // Runs on the decode thread, so the reader and resamplers are local to the
+    // load and can't be released by the host while they are in use
+    std::unique_ptr <juce::AudioFormatReader> fileReader1 (formatManager.createReaderFor(juce::File(filePath)));
     // Create an AudioFormatReaderSource for the fileReader1
-    filePlayer1 = std::make_unique <juce::AudioFormatReaderSource> (fileReader1.get(), false);
+    auto filePlayer1 = std::make_unique <juce::AudioFormatReaderSource> (fileReader1.get(), false);
     
     // resample uploaded audio 
     double resamplingRatio1 = modelSampleRate / fileReader1->sampleRate;
-    resampler1 = std::make_unique<juce::ResamplingAudioSource>(filePlayer1.get(), false, 1);
+    auto resampler1 = std::make_unique<juce::ResamplingAudioSource>(filePlayer1.get(), false, 1);
     resampler1->setResamplingRatio(resamplingRatio1);
     
     // Resize the loadedBuffer to store the resampled audio data
@@ -274,33 +549,243 @@ void AudioPluginAudioProcessor::setStateInformation (const void* data, int sizeI
         }
     }
     // Clear the changesApplied flag so we don't miss the newly set state information
-    changesApplied.clear();
+    requestUpdate();
 }
 
 //==================================================================================
 void AudioPluginAudioProcessor::valueTreePropertyChanged (juce::ValueTree &treeWhosePropertyHasChanged,
                                                           const juce::Identifier &property)
 {
+    if (isEnvelopeTree(treeWhosePropertyHasChanged))
+        refreshEnvelopes();
     // Checked in updateProcessors()  
+    requestUpdate();
+}
+
+void AudioPluginAudioProcessor::valueTreeChildAdded (juce::ValueTree &parentTree,
+                                                     juce::ValueTree &childWhichHasBeenAdded)
+{
+    if (isEnvelopeTree(parentTree) || isEnvelopeTree(childWhichHasBeenAdded))
+    {
+        refreshEnvelopes();
+        requestUpdate();
+    }
+}
+
+void AudioPluginAudioProcessor::valueTreeChildRemoved (juce::ValueTree &parentTree,
+                                                       juce::ValueTree &childWhichHasBeenRemoved,
+                                                       int indexFromWhichChildWasRemoved)
+{
+    juce::ignoreUnused (indexFromWhichChildWasRemoved);
+    if (isEnvelopeTree(parentTree) || isEnvelopeTree(childWhichHasBeenRemoved))
+    {
+        refreshEnvelopes();
+        requestUpdate();
+    }
+}
+
+void AudioPluginAudioProcessor::valueTreeRedirected (juce::ValueTree &treeWhichHasBeenChanged)
+{
+    // the whole state was replaced, e.g. by setStateInformation()
+    juce::ignoreUnused (treeWhichHasBeenChanged);
+    refreshEnvelopes();
+    requestUpdate();
+}
+
+bool AudioPluginAudioProcessor::isEnvelopeTree (const juce::ValueTree& tree) const
+{
+    return tree.hasType(LatentEnvelope::envelopesType)
+        || tree.hasType(LatentEnvelope::envelopeType)
+        || tree.hasType(LatentEnvelope::pointType);
+}
+
+void AudioPluginAudioProcessor::refreshEnvelopes()
+{
+    std::vector<LatentEnvelope> newEnvelopes;
+    newEnvelopes.reserve(vector_num);
+    for (int i = 0; i < vector_num; ++i)
+    {
+        newEnvelopes.emplace_back(LatentEnvelope::getTree(parameters.state, i));
+    }
+    {
+        const juce::ScopedLock sl(envelopeLock);
+        envelopes.swap(newEnvelopes);
+        ++envelopeRevision;
+    }
+    // restart the settle time, the decoder waits until the edit is finished
+    lastEnvelopeEdit.store(juce::Time::getMillisecondCounter());
+}
+
+void AudioPluginAudioProcessor::requestUpdate()
+{
     changesApplied.clear();
+    decodeThread.notify();
 }
 
-void AudioPluginAudioProcessor::updateProcessors()
+void AudioPluginAudioProcessor::DecodeThread::run()
 {
-    // load the new audio file into loadedBuffer (if any)
-    if (!newfile.test_and_set()){
-        loadAudioFile();
-        encoder();
-        changesApplied.clear();
+    while (!threadShouldExit())
+    {
+        // updateProcessors() returns how long to sleep: 0 = run again, -1 = until notified
+        auto waitMs = owner.updateProcessors();
+        // decode offline variants ahead of the notes that will use them
+        if (owner.prepareVariants())
+            waitMs = 0;
+        if (waitMs != 0)
+            wait(waitMs);
     }
-    // return if no parameter has been changed
-    if (changesApplied.test_and_set()){
+}
+
+int AudioPluginAudioProcessor::updateProcessors()
+{
+    try {
+        // load the new audio file into loadedBuffer (if any)
+        if (!newfile.test_and_set()){
+            // cached states and the playing clip belong to the previous file,
+            // even if this one fails to load
+            morphCache.clear();
+            markPublished(MorphCache::Key());
+            loadAudioFile();
+            encoder();
+            if (!batchProbed){
+                probeBatchedDecode();
+                batchProbed = true;
+            }
+            changesApplied.clear();
+        }
+        // hold off while an envelope is still being edited; the edit time is read
+        // before the counter and compared signed, so a concurrent edit can't wrap
+        // the difference around to look settled
+        auto lastEdit = lastEnvelopeEdit.load();
+        auto sinceEdit = static_cast<int>(juce::Time::getMillisecondCounter() - lastEdit);
+        if (sinceEdit < envelopeSettleMs){
+            return envelopeSettleMs - juce::jmax(0, sinceEdit);
+        }
+        // wait if no parameter has been changed
+        if (changesApplied.test_and_set()){
+            return -1;
+        }
+        auto key = getCurrentKey();
+        bool compact = compact_storage->load() > 0.5f;
+        // e.g. only the volume or randomisation changed, the playing clip is still right
+        if (isPublished(key, compact)){
+            return -1;
+        }
+        auto cached = morphCache.findExact(key);
+        std::shared_ptr<const ClipThumbnail> thumbnail;
+        if (cached != nullptr){
+            // this state was decoded recently, reuse it and its thumbnail
+            decodedClip.set(compact && !cached->isCompact() ? cached->createCompactCopy() : cached);
+            thumbnail = morphCache.findThumbnail(key);
+        }
+        else {
+            // modify latent representation if changesApplied is false, this also
+            // fixes the envelope revision of the key
+            latent_vectors = mod_latent(key);
+            // decode resultant latent representation
+            decoder();
+            thumbnail = createThumbnail();
+            morphCache.add(key, decodedClip.get(), thumbnail);
+        }
+        // after the clip, so the audio thread never pairs this key with the old one
+        markPublished(key);
+        publishThumbnail(thumbnail);
+    }
+    catch (const c10::Error& e) {
+        std::cout << "Error running the model: " << e.what() << std::endl;
+        // nothing will be published for this state, so play the last good clip
+        // rather than morphing until the next change
+        markPublished(getCurrentKey());
+    }
+    return 0;
+}
+
+std::shared_ptr<const ClipThumbnail> AudioPluginAudioProcessor::createThumbnail() const
+{
+    auto clip = decodedClip.get();
+    if (clip == nullptr)
+        return nullptr;
+
+    std::vector<float> samples(static_cast<size_t>(clip->getNumSamples()));
+    clip->read(samples.data(), 0, clip->getNumSamples());
+    auto latents = latent_vectors.contiguous();
+
+    return ClipThumbnail::create(samples.data(), clip->getNumSamples(),
+                                 latents.data_ptr<float>(),
+                                 static_cast<int>(latents.size(1)),
+                                 static_cast<int>(latents.size(-1)));
+}
+
+void AudioPluginAudioProcessor::publishThumbnail (std::shared_ptr<const ClipThumbnail> thumbnail)
+{
+    if (thumbnail == nullptr)
         return;
+    // an older thumbnail the editor never picked up can simply be dropped
+    delete pendingThumbnail.exchange(new std::shared_ptr<const ClipThumbnail>(std::move(thumbnail)));
+    thumbnailBroadcaster.sendChangeMessage();
+}
+
+void AudioPluginAudioProcessor::addThumbnailListener (juce::ChangeListener* listener)
+{
+    thumbnailBroadcaster.addChangeListener(listener);
+}
+
+void AudioPluginAudioProcessor::removeThumbnailListener (juce::ChangeListener* listener)
+{
+    thumbnailBroadcaster.removeChangeListener(listener);
+}
+
+std::shared_ptr<const ClipThumbnail> AudioPluginAudioProcessor::getThumbnail()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    if (auto* newest = pendingThumbnail.exchange(nullptr))
+    {
+        currentThumbnail = *newest;
+        delete newest;
+    }
+    return currentThumbnail;
+}
+
+MorphCache::Key AudioPluginAudioProcessor::getCurrentKey() const noexcept
+{
+    MorphCache::Key key;
+    for (int i = 0; i < vector_num; ++i)
+    {
+        key.values[i] = latent_controls[i]->load();
+    }
+    key.envelopeRevision = envelopeRevision.load();
+    return key;
+}
+
+bool AudioPluginAudioProcessor::isDecodePending (const MorphCache::Key& key) const noexcept
+{
+    const juce::SpinLock::ScopedTryLockType sl(publishedLock);
+    // the decoder is publishing right now, the next block will know more
+    return !sl.isLocked() || !morphCache.isSameState(publishedKey, key);
+}
+
+void AudioPluginAudioProcessor::markPublished (const MorphCache::Key& key)
+{
+    const juce::SpinLock::ScopedLockType sl(publishedLock);
+    publishedKey = key;
+}
+
+bool AudioPluginAudioProcessor::isPublished (const MorphCache::Key& key, bool compact) const
+{
+    {
+        const juce::SpinLock::ScopedLockType sl(publishedLock);
+        if (!morphCache.isSameState(publishedKey, key))
+            return false;
     }
-    // modify latent representation if changesApplied is false
-    mod_latent();
-    // decode resultant latent representation
-    decoder();
+    auto current = decodedClip.get();
+    if (current == nullptr || (compact && !current->isCompact()))
+        return false;
+    if (current->isCompact() == compact)
+        return true;
+    // compact but float32 was asked for: either compact storage was just turned
+    // off, which the cached float32 clip can undo, or the memory manager demoted it
+    auto cached = morphCache.findExact(key);
+    return cached == nullptr || cached->isCompact();
 }
 
 void AudioPluginAudioProcessor::populateParameterValues()
@@ -309,6 +794,7 @@ void AudioPluginAudioProcessor::populateParameterValues()
     // providing variable with pointers to the raw parameter values:
     output_volume = parameters.getRawParameterValue("volume");
     rand_control = parameters.getRawParameterValue("rand");
+    compact_storage = parameters.getRawParameterValue("compact");
     // for each latent control
     for (int i = 0; i < vector_num; ++i)
     {
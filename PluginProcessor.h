@@ -7,6 +7,12 @@
 #include <torch/script.h>
 #include <torch/torch.h>
 #include <juce_core/juce_core.h>
+#include "SampleStorage.h"
+#include "LatentEnvelope.h"
+#include "MorphCache.h"
+#include "ClipThumbnail.h"
+
+class BufferAudioSource;
 
 //==============================================================================
 class AudioPluginAudioProcessor  : public juce::AudioProcessor,
@@ -52,11 +58,33 @@ public:
     //==============================================================================
     void valueTreePropertyChanged (juce::ValueTree &treeWhosePropertyHasChanged,
                                    const juce::Identifier &property) override;
+    void valueTreeChildAdded (juce::ValueTree &parentTree,
+                              juce::ValueTree &childWhichHasBeenAdded) override;
+    void valueTreeChildRemoved (juce::ValueTree &parentTree,
+                                juce::ValueTree &childWhichHasBeenRemoved,
+                                int indexFromWhichChildWasRemoved) override;
+    void valueTreeRedirected (juce::ValueTree &treeWhichHasBeenChanged) override;
 
     //==============================================================================
     // Editor file selction
     std::atomic_flag newfile;
     juce::String filePath;
+    // wake the background decoder after changing filePath/newfile
+    void requestUpdate();
+
+    // Latency of the latest parameter or envelope change in milliseconds, -1 until
+    // it has been measured. Both start at the first block that sees the change and
+    // end when its exact decode is published, or when a playing voice first outputs
+    // audio for the new state (a morph of cached states or the exact decode). The
+    // host's own output buffering is not included. See benchmark/LatencyBenchmark.cpp
+    float getDecodeLatencyMs() const noexcept { return lastDecodeMs.load(); }
+    float getResponseLatencyMs() const noexcept { return lastResponseMs.load(); }
+
+    // Waveform/latent overview of the current decode. Listeners are told on the
+    // message thread when a new one is ready; getThumbnail() is message thread only.
+    void addThumbnailListener (juce::ChangeListener* listener);
+    void removeThumbnailListener (juce::ChangeListener* listener);
+    std::shared_ptr<const ClipThumbnail> getThumbnail();
 
 private:
     // Load resources
@@ -69,30 +97,108 @@ private:
     juce::AudioProcessorValueTreeState parameters;
     std::atomic <float>* output_volume;
     std::atomic <float>* rand_control;
+    std::atomic <float>* compact_storage;
     std::atomic_flag changesApplied;
     void populateParameterValues();
    
+    // Decoded sample storage, shared memory budget across all instances
+    juce::SharedResourcePointer <SampleMemoryManager> memoryManager;
+    SampleSlot decodedClip { *memoryManager, false };
+
     // Re-sampling and playback
     void loadAudioFile();
     int bufferReadPosition = 0;
     float outputGain = 0.0f;
 
     juce::AudioFormatManager formatManager;
-    std::unique_ptr <juce::AudioFormatReader> fileReader1;
-    std::unique_ptr <juce::AudioFormatReaderSource> filePlayer1;
-    std::unique_ptr <juce::PositionableAudioSource> filePlayer2;
-    std::unique_ptr <juce::ResamplingAudioSource> resampler1, resampler2;
+    std::unique_ptr <BufferAudioSource> filePlayer2;
+    std::unique_ptr <juce::ResamplingAudioSource> resampler2;
     juce::AudioBuffer<float> loadedBuffer;
 
     // Latent control & model functions
-    void updateProcessors();
-    void mod_latent();
+    int updateProcessors();
+    torch::Tensor mod_latent(MorphCache::Key& key);
     std::vector<std::atomic<float>*> latent_controls;
 
     void encoder();
     void decoder();
-    torch::Tensor latent_vectors, decoded_output, encoded_input; 
-    torch::Tensor delta, index;
+    torch::Tensor run_decoder(const torch::Tensor& latents);
+    torch::Tensor latent_vectors, encoded_input; 
+    // the model and encoded_input are shared with offline rendering
+    juce::CriticalSection modelLock;
+
+    // Offline (non-realtime) rendering with a freshly decoded variant per note.
+    // The decode thread keeps a few variants for the current state ready while
+    // the host renders, the audio thread only decodes notes it runs out for.
+    bool renderOffline(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+    bool takeVariants(int numNotes, std::vector<SampleClip::Ptr>& variants);
+    bool prepareVariants();
+    void registerVariants(const std::vector<SampleClip::Ptr>& variants);
+    bool matchesReadyVariants(const MorphCache::Key& key, float rand) const;
+    bool decodeVariants(int numNotes, float rand, MorphCache::Key& key, std::vector<SampleClip::Ptr>& variants);
+    std::atomic<bool> renderingOffline { false };
+    static const int numReadyVariants = 8;
+    juce::CriticalSection variantLock;
+    std::vector<SampleClip::Ptr> readyVariants, unregisteredVariants;
+    MorphCache::Key readyKey;
+    float readyRand = 0.0f;
+    // whether the model decodes a whole batch of variants at once, probed after the first encode
+    void probeBatchedDecode();
+    std::atomic<bool> batchedDecode { false };
+    bool batchProbed = false;
+    // decode thread: the latest variants, held in evictable slots so they count
+    // towards the memory budget
+    static const int numVariantSlots = 2 * numReadyVariants;
+    std::array<std::unique_ptr<SampleSlot>, numVariantSlots> variantSlots;
+    int nextVariantSlot = 0;
+
+    // Per-control latent envelopes, rebuilt from the state tree on the message
+    // thread and read by the decoder
+    void refreshEnvelopes();
+    bool isEnvelopeTree (const juce::ValueTree& tree) const;
+    std::vector<LatentEnvelope> envelopes;
+    juce::CriticalSection envelopeLock;
+    // breakpoint edits only trigger a decode once they have settled for this long
+    static const int envelopeSettleMs = 150;
+    std::atomic<juce::uint32> lastEnvelopeEdit { 0 };
+    std::atomic<int> envelopeRevision { 0 };
+
+    // Recently decoded states, blended while an exact decode is still pending
+    MorphCache morphCache;
+    MorphCache::Key getCurrentKey() const noexcept;
+    // Audio thread: true unless decodedClip holds the decode of exactly this state
+    bool isDecodePending (const MorphCache::Key& key) const noexcept;
+    // Decode thread: records which state was just put into decodedClip
+    void markPublished (const MorphCache::Key& key);
+    // Decode thread: true if decodedClip already holds this state in the requested storage
+    bool isPublished (const MorphCache::Key& key, bool compact) const;
+    MorphCache::Key publishedKey;
+    mutable juce::SpinLock publishedLock;
+    MorphCache::Key morphKey;       // audio thread: state the playing morph was found for
+    bool waitingForExact = false;
+
+    // Latency bookkeeping, audio thread only
+    MorphCache::Key measuredKey;
+    double keyChangeTime = 0.0;
+    bool awaitingExact = false, awaitingResponse = false;
+    std::atomic<float> lastDecodeMs { -1.0f }, lastResponseMs { -1.0f };
+
+    // Thumbnails are handed from the decoder to the message thread by swapping
+    // ownership of a single pointer, no lock is shared with the editor
+    std::shared_ptr<const ClipThumbnail> createThumbnail() const;
+    void publishThumbnail (std::shared_ptr<const ClipThumbnail> thumbnail);
+    std::atomic<std::shared_ptr<const ClipThumbnail>*> pendingThumbnail { nullptr };
+    std::shared_ptr<const ClipThumbnail> currentThumbnail;
+    juce::ChangeBroadcaster thumbnailBroadcaster;
+
+    // Encoding and decoding run here, never on the audio thread
+    struct DecodeThread : public juce::Thread
+    {
+        DecodeThread (AudioPluginAudioProcessor& p) : juce::Thread ("Simpact decoder"), owner (p) {}
+        void run() override;
+        AudioPluginAudioProcessor& owner;
+    };
+    DecodeThread decodeThread { *this };
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioPluginAudioProcessor);
@@ -101,49 +207,122 @@ private:
 class BufferAudioSource : public juce::PositionableAudioSource
 {
 public:
-    BufferAudioSource(juce::AudioBuffer<float>& buffer)
-        : buffer(buffer), readPosition(0) {}
+    BufferAudioSource(SampleSlot& slot)
+        : slot(slot), readPosition(0) {}
 
     void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override
     {
+        // scratch space for mixing morph sources, larger requests are split up
+        scratch.setSize(2, juce::jmax(512, samplesPerBlockExpected));
     }
 
     void releaseResources() override
     {
     }
-    
-    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override
+
+    // Play the slot's clip, following it whenever a new decode is published.
+    void playExact()
     {
-        int numSamples = bufferToFill.numSamples;
-        int position = bufferToFill.startSample;
+        morphing = false;
+        fadingToExact = false;
+        first = nullptr;
+        second = nullptr;
+    }
 
-        int samplesAvailable = buffer.getNumSamples() - readPosition;
+    // Play an equal-power mix of two cached clips instead of the slot's clip
+    // until swapToExact() is called.
+    void startMorph(SampleClip::Ptr newFirst, float newFirstGain, SampleClip::Ptr newSecond, float newSecondGain)
+    {
+        first = newFirst;
+        second = newSecond;
+        firstGain = newFirstGain;
+        secondGain = newSecondGain;
+        morphing = true;
+        fadingToExact = false;
+    }
+
+    // Play a clip that isn't kept in the slot, e.g. a per-note variant.
+    void playClip(SampleClip::Ptr variant)
+    {
+        startMorph(variant, 1.0f, nullptr, 0.0f);
+    }
 
-        // Check if the requested number of samples is available
-        if (samplesAvailable < numSamples)
+    // Crossfade from the morph to the slot's clip now that the exact decode is in it.
+    // Returns false if the slot is being written to, try again on the next block.
+    bool swapToExact()
+    {
+        if (!slot.retainCurrent(clip))
+            return false;
+        if (morphing)
         {
-            numSamples = samplesAvailable;
-            bufferToFill.clearActiveBufferRegion();
+            fadingToExact = true;
+            fadePosition = 0;
         }
+        return true;
+    }
+    
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override
+    {
+        int numSamples = bufferToFill.numSamples;
+        float* output = bufferToFill.buffer->getWritePointer(0, bufferToFill.startSample);
+        bufferToFill.clearActiveBufferRegion();
 
-        // If there are no more samples, return early
-        if (numSamples <= 0)
+        if (!morphing)
         {
-            bufferToFill.clearActiveBufferRegion();
+            // pick up a newly decoded (or demoted) clip without blocking
+            slot.retainCurrent(clip);
+            // clips are mono, decoded straight into the first channel
+            int samplesAvailable = juce::jmin(numSamples, getLength() - readPosition);
+            if (samplesAvailable > 0)
+            {
+                clip->read(output, readPosition, samplesAvailable);
+                readPosition += samplesAvailable;
+            }
             return;
         }
 
-        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+        for (int done = 0; done < numSamples;)
         {
-            bufferToFill.buffer->copyFrom(channel, position, buffer, channel, readPosition, numSamples);
+            // stops at the end of the longest source, or if not prepared
+            int chunk = juce::jmin(numSamples - done, scratch.getNumSamples(), getLength() - readPosition);
+            if (chunk <= 0)
+                break;
+            float* out = output + done;
+            addClip(first.get(), firstGain, out, readPosition, chunk);
+            addClip(second.get(), secondGain, out, readPosition, chunk);
+
+            if (fadingToExact)
+            {
+                // linear rather than equal-power: morph and exact are strongly
+                // correlated, so an equal-power fade would bump the level
+                float* exact = scratch.getWritePointer(1);
+                juce::FloatVectorOperations::clear(exact, chunk);
+                int samplesAvailable = clip != nullptr ? juce::jmin(chunk, clip->getNumSamples() - readPosition) : 0;
+                if (samplesAvailable > 0)
+                    clip->read(exact, readPosition, samplesAvailable);
+                for (int i = 0; i < chunk; ++i)
+                {
+                    float amount = juce::jmin(1.0f, static_cast<float>(fadePosition++) / fadeLength);
+                    out[i] += (exact[i] - out[i]) * amount;
+                }
+            }
+            readPosition += chunk;
+            done += chunk;
         }
 
-        readPosition += numSamples;
+        if (fadingToExact && (fadePosition >= fadeLength || hasFinished()))
+            playExact();
+    }
+
+    // True once every source in play has been read to its end.
+    bool hasFinished() const noexcept
+    {
+        return readPosition >= getLength();
     }
 
     void setNextReadPosition(juce::int64 newPosition) override
     {
-        readPosition = static_cast<int>(newPosition);
+        readPosition = static_cast<int>(juce::jmax(juce::int64(0), newPosition));
     }
 
     juce::int64 getNextReadPosition() const override
@@ -153,7 +332,7 @@ public:
 
     juce::int64 getTotalLength() const override
     {
-        return buffer.getNumSamples();
+        return getLength();
     }
 
     bool isLooping() const override
@@ -166,6 +345,36 @@ public:
     }
 
 private:
-    juce::AudioBuffer<float>& buffer;
+    // length of the longest clip currently in play
+    int getLength() const noexcept
+    {
+        int length = clip != nullptr ? clip->getNumSamples() : 0;
+        if (morphing)
+        {
+            length = juce::jmax(length, first != nullptr ? first->getNumSamples() : 0,
+                                second != nullptr ? second->getNumSamples() : 0);
+        }
+        return length;
+    }
+
+    // adds gain * clip[position, position + numSamples) to out, using scratch channel 0
+    void addClip(const SampleClip* source, float gain, float* out, int position, int numSamples)
+    {
+        int samplesAvailable = source != nullptr ? juce::jmin(numSamples, source->getNumSamples() - position) : 0;
+        if (samplesAvailable <= 0 || gain <= 0.0f)
+            return;
+        float* temp = scratch.getWritePointer(0);
+        source->read(temp, position, samplesAvailable);
+        juce::FloatVectorOperations::addWithMultiply(out, temp, gain, samplesAvailable);
+    }
+
+    static const int fadeLength = 256; // samples at the model rate
+
+    SampleSlot& slot;
+    SampleClip::Ptr clip, first, second;
+    float firstGain = 1.0f, secondGain = 0.0f;
+    bool morphing = false, fadingToExact = false;
+    int fadePosition = 0;
+    juce::AudioBuffer<float> scratch;
     int readPosition;
 };
@@ -0,0 +1,300 @@
+#include "SampleStorage.h"
+#include <unordered_map>
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+#elif JUCE_ARM && (defined (__ARM_NEON) || defined (__ARM_NEON__) || defined (_M_ARM64))
+ #include <arm_neon.h>
+ #define SIMPACT_USE_NEON 1
+#endif
+
+//==============================================================================
+static void convertInt16ToFloat (float* dest, const juce::int16* src, float scale, int numSamples) noexcept
+{
+    int i = 0;
+   #if JUCE_INTEL
+    // 8 samples per iteration: sign-extend to 32 bit, convert and scale.
+    const __m128 scaleVec = _mm_set1_ps (scale);
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const __m128i packed = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (src + i));
+        const __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (packed, packed), 16);
+        const __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (packed, packed), 16);
+        _mm_storeu_ps (dest + i,     _mm_mul_ps (_mm_cvtepi32_ps (lo), scaleVec));
+        _mm_storeu_ps (dest + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), scaleVec));
+    }
+   #elif SIMPACT_USE_NEON
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        const int16x8_t packed = vld1q_s16 (src + i);
+        vst1q_f32 (dest + i,     vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (packed))), scale));
+        vst1q_f32 (dest + i + 4, vmulq_n_f32 (vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (packed))), scale));
+    }
+   #endif
+    for (; i < numSamples; ++i)
+        dest[i] = static_cast<float> (src[i]) * scale;
+}
+
+//==============================================================================
+SampleClip::SampleClip (int numSamplesToHold, bool shouldBeCompact)
+    : numSamples (numSamplesToHold), compact (shouldBeCompact)
+{
+    if (compact)
+        compactData.malloc (static_cast<size_t> (numSamples));
+    else
+        floatData.malloc (static_cast<size_t> (numSamples));
+}
+
+SampleClip::Ptr SampleClip::createFromData (const float* data, int numSamples, bool compact)
+{
+    Ptr clip (new SampleClip (numSamples, compact));
+
+    if (! compact)
+    {
+        juce::FloatVectorOperations::copy (clip->floatData.get(), data, numSamples);
+        return clip;
+    }
+
+    // Scale to the clip's own peak so quiet clips keep their resolution.
+    auto range = juce::FloatVectorOperations::findMinAndMax (data, numSamples);
+    auto peak = juce::jmax (std::abs (range.getStart()), std::abs (range.getEnd()));
+    clip->compactScale = peak > 0.0f ? peak / 32767.0f : 1.0f;
+
+    const float toInt = 1.0f / clip->compactScale;
+    for (int i = 0; i < numSamples; ++i)
+        clip->compactData[i] = static_cast<juce::int16> (juce::roundToInt (data[i] * toInt));
+
+    return clip;
+}
+
+SampleClip::Ptr SampleClip::createCompactCopy() const
+{
+    jassert (! compact);
+    return createFromData (floatData.get(), numSamples, true);
+}
+
+size_t SampleClip::getSizeInBytes() const noexcept
+{
+    return static_cast<size_t> (numSamples) * (compact ? sizeof (juce::int16) : sizeof (float));
+}
+
+void SampleClip::read (float* dest, int startSample, int numSamplesToRead) const noexcept
+{
+    jassert (startSample >= 0 && startSample + numSamplesToRead <= numSamples);
+
+    if (compact)
+        convertInt16ToFloat (dest, compactData.get() + startSample, compactScale, numSamplesToRead);
+    else
+        juce::FloatVectorOperations::copy (dest, floatData.get() + startSample, numSamplesToRead);
+}
+
+//==============================================================================
+SampleSlot::SampleSlot (SampleMemoryManager& owner, bool canBeEvicted)
+    : manager (owner), evictable (canBeEvicted)
+{
+    manager.registerSlot (this);
+}
+
+SampleSlot::~SampleSlot()
+{
+    manager.unregisterSlot (this);
+}
+
+void SampleSlot::set (SampleClip::Ptr newClip)
+{
+    manager.publish (*this, newClip);
+    markTriggered();
+}
+
+SampleClip::Ptr SampleSlot::get() const
+{
+    const juce::SpinLock::ScopedLockType sl (lock);
+    return clip;
+}
+
+bool SampleSlot::retainCurrent (SampleClip::Ptr& retained) const noexcept
+{
+    const juce::SpinLock::ScopedTryLockType sl (lock);
+
+    if (! sl.isLocked())
+        return false;
+
+    if (retained != clip)
+        retained = clip;
+
+    return true;
+}
+
+void SampleSlot::markTriggered() noexcept
+{
+    lastTriggered.store (juce::Time::getMillisecondCounter());
+}
+
+//==============================================================================
+constexpr size_t SampleMemoryManager::budget;
+
+SampleMemoryManager::SampleMemoryManager()
+    : juce::Thread ("Simpact sample memory")
+{
+    startThread();
+}
+
+SampleMemoryManager::~SampleMemoryManager()
+{
+    stopThread (2000);
+}
+
+size_t SampleMemoryManager::getTotalBytes() const
+{
+    const juce::ScopedLock sl (lock);
+    return totalBytes;
+}
+
+void SampleMemoryManager::publish (SampleSlot& slot, SampleClip::Ptr newClip)
+{
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (newClip != nullptr)
+            clips.addIfNotAlreadyThere (newClip.get());
+
+        swapClip (slot, newClip);
+    }
+    notify();
+}
+
+void SampleMemoryManager::swapClip (SampleSlot& slot, SampleClip::Ptr& clipToSwap)
+{
+    {
+        const juce::SpinLock::ScopedLockType sl (slot.lock);
+        slot.clip.swapWith (clipToSwap);
+    }
+
+    // Only the manager writes slot.clip, so it can be read here without the
+    // slot's lock. A clip takes up memory once, however many slots hold it.
+    if (auto* added = slot.clip.get())
+        if (added->numSlots++ == 0)
+            totalBytes += added->getSizeInBytes();
+
+    if (auto* removed = clipToSwap.get())
+        if (--removed->numSlots == 0)
+            totalBytes -= removed->getSizeInBytes();
+}
+
+void SampleMemoryManager::replaceEverywhere (const SampleClip* oldClip, SampleClip::Ptr newClip)
+{
+    for (auto* slot : slots)
+    {
+        if (slot->clip.get() == oldClip)
+        {
+            auto replacement = newClip;
+            swapClip (*slot, replacement);
+        }
+    }
+}
+
+void SampleMemoryManager::registerSlot (SampleSlot* slot)
+{
+    const juce::ScopedLock sl (lock);
+    slots.addIfNotAlreadyThere (slot);
+}
+
+void SampleMemoryManager::unregisterSlot (SampleSlot* slot)
+{
+    const juce::ScopedLock sl (lock);
+    slots.removeFirstMatchingValue (slot);
+
+    SampleClip::Ptr none;
+    swapClip (*slot, none);
+}
+
+void SampleMemoryManager::run()
+{
+    while (! threadShouldExit())
+    {
+        releaseUnusedClips();
+        enforceBudget();
+        wait (500);
+    }
+}
+
+void SampleMemoryManager::releaseUnusedClips()
+{
+    const juce::ScopedLock sl (lock);
+
+    for (int i = clips.size(); --i >= 0;)
+        if (clips.getObjectPointerUnchecked (i)->getReferenceCount() == 1)
+            clips.remove (i);
+}
+
+void SampleMemoryManager::enforceBudget()
+{
+    struct Candidate
+    {
+        SampleClip::Ptr clip;
+        juce::uint32 lastTriggered;
+        bool evictable;
+    };
+
+    std::vector<Candidate> candidates;
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (totalBytes <= budget)
+            return;
+
+        // One candidate per clip, however many slots share it. A clip can only
+        // be evicted if every slot holding it allows that.
+        std::unordered_map<const SampleClip*, size_t> indices;
+
+        for (auto* slot : slots)
+        {
+            if (slot->clip == nullptr)
+                continue;
+
+            auto found = indices.find (slot->clip.get());
+
+            if (found == indices.end())
+            {
+                indices[slot->clip.get()] = candidates.size();
+                candidates.push_back ({ slot->clip, slot->getLastTriggerTime(), slot->isEvictable() });
+                continue;
+            }
+
+            auto& candidate = candidates[found->second];
+            candidate.lastTriggered = juce::jmax (candidate.lastTriggered, slot->getLastTriggerTime());
+            candidate.evictable = candidate.evictable && slot->isEvictable();
+        }
+    }
+
+    // Least recently triggered first.
+    std::sort (candidates.begin(), candidates.end(), [] (const Candidate& a, const Candidate& b)
+    {
+        return a.lastTriggered < b.lastTriggered;
+    });
+
+    for (auto& candidate : candidates)
+    {
+        if (getTotalBytes() <= budget)
+            break;
+
+        if (candidate.evictable)
+        {
+            const juce::ScopedLock sl (lock);
+            replaceEverywhere (candidate.clip.get(), nullptr);
+        }
+        else if (! candidate.clip->isCompact())
+        {
+            // Converted without the lock so other threads can keep publishing;
+            // a slot that has moved on to a new clip in the meantime is left alone.
+            auto compactClip = candidate.clip->createCompactCopy();
+
+            const juce::ScopedLock sl (lock);
+            clips.addIfNotAlreadyThere (compactClip.get());
+            replaceEverywhere (candidate.clip.get(), compactClip);
+        }
+    }
+
+    candidates.clear();
+    releaseUnusedClips();
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+class SampleMemoryManager;
+
+//==============================================================================
+// An immutable, mono decoded clip. The sample data never changes after creation
+// so the audio thread can read it without locking. Samples are held either as
+// float32 or as a compact int16 copy that is expanded back to float on read.
+class SampleClip : public juce::ReferenceCountedObject
+{
+public:
+    using Ptr = juce::ReferenceCountedObjectPtr<SampleClip>;
+
+    static Ptr createFromData (const float* data, int numSamples, bool compact);
+    // Only valid for float32 clips.
+    Ptr createCompactCopy() const;
+
+    bool isCompact() const noexcept     { return compact; }
+    int getNumSamples() const noexcept  { return numSamples; }
+    size_t getSizeInBytes() const noexcept;
+
+    // Writes numSamplesToRead samples starting at startSample into dest.
+    // Compact clips are decoded with SIMD int16 -> float conversion.
+    void read (float* dest, int startSample, int numSamplesToRead) const noexcept;
+
+private:
+    SampleClip (int numSamples, bool compact);
+
+    friend class SampleMemoryManager;
+
+    const int numSamples;
+    const bool compact;
+    float compactScale = 1.0f;
+    juce::HeapBlock<float> floatData;
+    juce::HeapBlock<juce::int16> compactData;
+    int numSlots = 0; // slots holding this clip, guarded by the manager's lock
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleClip)
+};
+
+//==============================================================================
+// Holds the clip currently in use for one purpose (the decoded sample of an
+// instance, a cache entry, ...) and registers it with the global memory
+// manager. The manager may swap the clip for a compact copy at any time, or
+// drop it entirely if every slot holding it was created as evictable.
+class SampleSlot
+{
+public:
+    SampleSlot (SampleMemoryManager& manager, bool evictable);
+    ~SampleSlot();
+
+    // Publishes a new clip. Must not be called from the audio thread.
+    void set (SampleClip::Ptr newClip);
+    SampleClip::Ptr get() const;
+
+    // Audio thread access: refreshes `retained` with the current clip unless the
+    // slot is being written to right now, in which case the old one is kept and
+    // false is returned.
+    bool retainCurrent (SampleClip::Ptr& retained) const noexcept;
+
+    void markTriggered() noexcept;
+    juce::uint32 getLastTriggerTime() const noexcept    { return lastTriggered.load(); }
+    bool isEvictable() const noexcept                   { return evictable; }
+
+private:
+    friend class SampleMemoryManager;
+
+    SampleMemoryManager& manager;
+    const bool evictable;
+    mutable juce::SpinLock lock;
+    SampleClip::Ptr clip;
+    std::atomic<juce::uint32> lastTriggered { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSlot)
+};
+
+//==============================================================================
+// Shared by every plugin instance in the process (use it through a
+// juce::SharedResourcePointer). Keeps the clips held by all registered slots
+// (each counted once) under a fixed budget of 512 MB by demoting the
+// least-recently-triggered clips to int16, or evicting them if only evictable
+// slots hold them, and makes sure clips are only ever freed on its own thread.
+// Clips only count towards the budget while they are in a slot.
+class SampleMemoryManager : private juce::Thread
+{
+public:
+    SampleMemoryManager();
+    ~SampleMemoryManager() override;
+
+    static constexpr size_t budget = 512 * 1024 * 1024;
+
+private:
+    friend class SampleSlot;
+    void registerSlot (SampleSlot* slot);
+    void unregisterSlot (SampleSlot* slot);
+    // Puts newClip into the slot and keeps a reference to it until nobody else
+    // holds one, so the last reference is never dropped (and the memory never
+    // freed) on the audio thread.
+    void publish (SampleSlot& slot, SampleClip::Ptr newClip);
+
+    // These expect the lock to be held.
+    void swapClip (SampleSlot& slot, SampleClip::Ptr& clipToSwap);
+    void replaceEverywhere (const SampleClip* oldClip, SampleClip::Ptr newClip);
+
+    size_t getTotalBytes() const;
+    void run() override;
+    void releaseUnusedClips();
+    void enforceBudget();
+
+    juce::CriticalSection lock;
+    juce::Array<SampleSlot*> slots;
+    juce::ReferenceCountedArray<SampleClip> clips;
+    size_t totalBytes = 0; // each clip in a slot counted once
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleMemoryManager)
+};
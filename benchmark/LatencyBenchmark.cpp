@@ -0,0 +1,116 @@
+#include "../PluginProcessor.h"
+#include <iostream>
+
+// Runs the processor without a host and measures how long a latent control
+// change takes to be heard. Each trial moves "1-control" and triggers a note in
+// the same block, then keeps processing realtime-paced blocks until both the
+// response latency (first audio for the new state, possibly a morph) and the
+// exact decode latency have been reported by the processor.
+
+static const double sampleRate = 44100.0;
+static const int blockSize = 512;
+static const int numTrials = 20;
+static const double trialTimeoutMs = 10000.0;
+static const int retriggerBlocks = 20;
+
+struct LatencyStats
+{
+    void add (float value)
+    {
+        minimum = values.empty() ? value : juce::jmin (minimum, value);
+        maximum = values.empty() ? value : juce::jmax (maximum, value);
+        values.push_back (value);
+    }
+
+    void print (const juce::String& name) const
+    {
+        double sum = 0.0;
+        for (auto value : values)
+            sum += value;
+        std::cout << name << ": min " << minimum << " ms, mean " << sum / static_cast<double> (values.size())
+                  << " ms, max " << maximum << " ms (" << values.size() << " trials)" << std::endl;
+    }
+
+    std::vector<float> values;
+    float minimum = 0.0f, maximum = 0.0f;
+};
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    AudioPluginAudioProcessor processor;
+    processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    juce::AudioProcessorParameterWithID* control = nullptr;
+    for (auto* parameter : processor.getParameters())
+    {
+        auto* withID = dynamic_cast<juce::AudioProcessorParameterWithID*> (parameter);
+        if (withID != nullptr && withID->paramID == "1-control")
+            control = withID;
+    }
+    if (control == nullptr)
+    {
+        std::cerr << "The processor has no 1-control parameter" << std::endl;
+        return 1;
+    }
+
+    juce::AudioBuffer<float> buffer (juce::jmax (1, processor.getTotalNumOutputChannels()), blockSize);
+    juce::MidiBuffer midi;
+    const int blockMs = juce::roundToInt (1000.0 * blockSize / sampleRate);
+
+    auto processBlock = [&] (bool noteOn)
+    {
+        midi.clear();
+        if (noteOn)
+            midi.addEvent (juce::MidiMessage::noteOn (1, 60, 1.0f), 0);
+        buffer.clear();
+        processor.processBlock (buffer, midi);
+        // pace the blocks like an audio device, the message thread runs in between
+        juce::MessageManager::getInstance()->runDispatchLoopUntil (blockMs);
+    };
+
+    // wait for the default file to be encoded and the first decode published
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    while (processor.getThumbnail() == nullptr)
+    {
+        if (juce::Time::getMillisecondCounterHiRes() - start > trialTimeoutMs * 6)
+        {
+            std::cerr << "The model did not produce a first decode" << std::endl;
+            return 1;
+        }
+        processBlock (false);
+    }
+
+    LatencyStats response, decode;
+    juce::Random random (1234);
+    for (int trial = 0; trial < numTrials; ++trial)
+    {
+        // nearby values, so later trials can morph between earlier decodes
+        control->setValueNotifyingHost (0.5f + (random.nextFloat() - 0.5f) * 0.3f);
+
+        // the processor sees the change in this block and resets both latencies
+        start = juce::Time::getMillisecondCounterHiRes();
+        processBlock (true);
+        for (int block = 1; processor.getResponseLatencyMs() < 0.0f || processor.getDecodeLatencyMs() < 0.0f; ++block)
+        {
+            if (juce::Time::getMillisecondCounterHiRes() - start > trialTimeoutMs)
+            {
+                std::cerr << "Trial " << trial << " timed out" << std::endl;
+                return 1;
+            }
+            // keep a note sounding until audio for the new state has been heard
+            processBlock (block % retriggerBlocks == 0 && processor.getResponseLatencyMs() < 0.0f);
+        }
+
+        response.add (processor.getResponseLatencyMs());
+        decode.add (processor.getDecodeLatencyMs());
+    }
+
+    response.print ("Response latency");
+    decode.print ("Exact decode latency");
+
+    processor.releaseResources();
+    return 0;
+}